@@ -0,0 +1,205 @@
+/* cpu-query
+ *
+ * Query CPU sets from sysfs and procfs
+ *
+ * Supported format(s):
+ * list  "0-3,8,10-11"                  (e.g. smp_affinity_list)
+ * mask  "00000000,0000ff0f"            (e.g. rps_cpus)
+ *
+ * CPU state (isolated, nohz_full, online) is read from
+ * /sys/devices/system/cpu by cpu_init() and kept until cpu_free().
+ * Allowed CPUs are the affinity of this process, which is limited by
+ * the cpuset of its cgroup (e.g. of its container).
+ */
+
+#include <string>
+#include <set>
+#include <sched.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "fsroot.hpp"
+#include "cpu-query.hpp"
+
+namespace fs = boost::filesystem;
+
+using namespace std;
+
+set<unsigned int> isolated_cpus;
+set<unsigned int> nohz_full_cpus;
+set<unsigned int> online_cpus;
+bool online_known = false;
+set<unsigned int> allowed_cpus;
+bool allowed_known = false;
+
+set<unsigned int> parse_cpu_list(string list)
+{
+	set<unsigned int> cpus;
+	vector<string> ranges;
+
+	boost::trim(list);
+	if (list.empty())
+		return cpus;
+
+	boost::split(ranges, list, boost::is_any_of(","));
+	for (auto r: ranges)
+	{
+		size_t dash = r.find('-');
+		try {
+			unsigned int first = stoul(r.substr(0, dash));
+			unsigned int last = first;
+			if (dash != string::npos)
+				last = stoul(r.substr(dash + 1));
+			for (unsigned int cpu = first; cpu <= last; cpu++)
+				cpus.insert(cpu);
+		} catch (...) {
+			continue;
+		}
+	}
+
+	return cpus;
+}
+
+set<unsigned int> parse_cpu_mask(string mask)
+{
+	set<unsigned int> cpus;
+	unsigned int bit = 0;
+
+	boost::trim(mask);
+
+	// Least significant digit is the last one
+	for (auto c = mask.rbegin(); c != mask.rend(); c++)
+	{
+		if (*c == ',')
+			continue;
+
+		unsigned int digit;
+		if (*c >= '0' && *c <= '9')
+			digit = *c - '0';
+		else if (*c >= 'a' && *c <= 'f')
+			digit = *c - 'a' + 10;
+		else if (*c >= 'A' && *c <= 'F')
+			digit = *c - 'A' + 10;
+		else
+			break;
+
+		for (int i = 0; i < 4; i++)
+			if (digit & (1 << i))
+				cpus.insert(bit + i);
+		bit += 4;
+	}
+
+	return cpus;
+}
+
+static int read_line(string &line, string path)
+{
+	fs::path p(path);
+	if (!fs::exists(p) || !fs::is_regular_file(p))
+		return 1;
+
+	try {
+		fs::ifstream fin(p);
+		getline(fin, line);
+		fin.close();
+	} catch (...) {
+		return 1;
+	}
+
+	return 0;
+}
+
+// Read a CPU list file
+//
+// Returns
+// 0    success
+// else failed
+int read_cpu_list(set<unsigned int> &cpus, string path)
+{
+	string line;
+	if (read_line(line, path))
+		return 1;
+
+	cpus = parse_cpu_list(line);
+	return 0;
+}
+
+// Read a CPU mask file
+//
+// Returns
+// 0    success
+// else failed
+int read_cpu_mask(set<unsigned int> &cpus, string path)
+{
+	string line;
+	if (read_line(line, path))
+		return 1;
+
+	cpus = parse_cpu_mask(line);
+	return 0;
+}
+
+// Read CPUs in the affinity of this process
+//
+// Returns
+// 0    success
+// else failed
+int get_allowed_cpus(set<unsigned int> &cpus)
+{
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		return 1;
+
+	cpus.clear();
+	for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &mask))
+			cpus.insert(cpu);
+	return 0;
+}
+
+// Fills CPU state sets
+void cpu_init()
+{
+	const string p(fsroot_path("/sys/devices/system/cpu/"));
+
+	read_cpu_list(isolated_cpus, p + "isolated");
+	read_cpu_list(nohz_full_cpus, p + "nohz_full");
+	online_known = !read_cpu_list(online_cpus, p + "online");
+
+	allowed_known = !get_allowed_cpus(allowed_cpus);
+}
+
+// Free CPU state sets
+void cpu_free()
+{
+	isolated_cpus.clear();
+	nohz_full_cpus.clear();
+	online_cpus.clear();
+	online_known = false;
+	allowed_cpus.clear();
+	allowed_known = false;
+}
+
+bool is_isolated_cpu(unsigned int cpu)
+{
+	return isolated_cpus.count(cpu) > 0;
+}
+
+bool is_nohz_full_cpu(unsigned int cpu)
+{
+	return nohz_full_cpus.count(cpu) > 0;
+}
+
+// CPUs are considered online if the online mask is not available
+bool is_online_cpu(unsigned int cpu)
+{
+	return !online_known || online_cpus.count(cpu) > 0;
+}
+
+// CPUs are considered allowed if the affinity is not available
+bool is_allowed_cpu(unsigned int cpu)
+{
+	return !allowed_known || allowed_cpus.count(cpu) > 0;
+}
@@ -0,0 +1,21 @@
+/* cpu-query
+ *
+ * Query CPU sets from sysfs and procfs
+ * header file
+ */
+
+#include <string>
+#include <set>
+
+std::set<unsigned int> parse_cpu_list(std::string list);
+std::set<unsigned int> parse_cpu_mask(std::string mask);
+int read_cpu_list(std::set<unsigned int> &cpus, std::string path);
+int read_cpu_mask(std::set<unsigned int> &cpus, std::string path);
+
+void cpu_init();
+void cpu_free();
+bool is_isolated_cpu(unsigned int cpu);
+bool is_nohz_full_cpu(unsigned int cpu);
+bool is_online_cpu(unsigned int cpu);
+bool is_allowed_cpu(unsigned int cpu);
+int get_allowed_cpus(std::set<unsigned int> &cpus);
@@ -39,6 +39,8 @@
 #include <boost/regex.hpp>
 #include <boost/range/iterator_range.hpp>
 
+#include "fsroot.hpp"
+
 namespace fs = boost::filesystem;
 
 using namespace std;
@@ -48,7 +50,7 @@ map<string,string> dpdk_interfaces;
 // Fills DPDK interface map
 void dpdk_init()
 {
-	fs::path p("/sys/bus/pci/drivers/igb_uio/");
+	fs::path p(fsroot_path("/sys/bus/pci/drivers/igb_uio/"));
 	if (fs::exists(p) && fs::is_directory(p))
 	{
 		vector<string> ifaces;
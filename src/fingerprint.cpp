@@ -0,0 +1,108 @@
+/* fingerprint
+ *
+ * Fingerprint of the inputs of the conversion
+ *
+ * Covers the boot id, the online CPUs, the PCI devices with their
+ * driver bindings and the network interfaces with their speed and
+ * flags. It only takes a handful of sysfs reads, so it can be computed
+ * before the (much more expensive) topology discovery.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "fsroot.hpp"
+#include "fingerprint.hpp"
+
+namespace fs = boost::filesystem;
+
+using namespace std;
+
+// 64 bit FNV-1a
+class FNV
+{
+	private:
+	unsigned long long hash = 14695981039346656037ULL;
+
+	public:
+	void add(const string &s)
+	{
+		for (unsigned char c: s)
+		{
+			hash ^= c;
+			hash *= 1099511628211ULL;
+		}
+		// Separator, so "ab"+"c" differs from "a"+"bc"
+		hash ^= 0xff;
+		hash *= 1099511628211ULL;
+	}
+
+	string hex()
+	{
+		char buf[17];
+		snprintf(buf, sizeof(buf), "%016llx", hash);
+		return buf;
+	}
+};
+
+static string read_first_line(fs::path p)
+{
+	string line;
+
+	try {
+		fs::ifstream fin(p);
+		getline(fin, line);
+		fin.close();
+	} catch (...) {
+		line.clear();
+	}
+
+	return line;
+}
+
+static vector<fs::path> sorted_entries(fs::path p)
+{
+	vector<fs::path> entries;
+
+	if (fs::exists(p) && fs::is_directory(p))
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(p), {}))
+			entries.push_back(entry.path());
+
+	sort(entries.begin(), entries.end());
+	return entries;
+}
+
+// Returns fingerprint as a hex string
+string get_input_fingerprint(string extra)
+{
+	FNV fnv;
+
+	fnv.add(extra);
+	fnv.add(read_first_line(fsroot_path("/proc/sys/kernel/random/boot_id")));
+	fnv.add(read_first_line(fsroot_path("/sys/devices/system/cpu/online")));
+
+	// PCI devices and their drivers
+	for (auto &dev: sorted_entries(fsroot_path("/sys/bus/pci/devices/")))
+	{
+		fnv.add(dev.filename().string());
+
+		boost::system::error_code ec;
+		fs::path driver = fs::read_symlink(dev / "driver", ec);
+		fnv.add(ec ? "" : driver.filename().string());
+	}
+
+	// Network interfaces
+	for (auto &iface: sorted_entries(fsroot_path("/sys/class/net/")))
+	{
+		fnv.add(iface.filename().string());
+		fnv.add(read_first_line(iface / "speed"));
+		fnv.add(read_first_line(iface / "flags"));
+	}
+
+	return fnv.hex();
+}
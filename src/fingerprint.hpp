@@ -0,0 +1,9 @@
+/* fingerprint
+ *
+ * Fingerprint of the inputs of the conversion
+ * header file
+ */
+
+#include <string>
+
+std::string get_input_fingerprint(std::string extra);
@@ -0,0 +1,37 @@
+/* fsroot
+ *
+ * Root of the queried /sys and /proc filesystems
+ *
+ * By default the filesystems of the running system are queried. In a
+ * container the host's filesystems can be bind-mounted (e.g. to /host)
+ * and queried instead by setting the root.
+ */
+
+#include <string>
+
+#include "fsroot.hpp"
+
+using namespace std;
+
+string fsroot;
+
+void set_fsroot(string root)
+{
+	// "/" and "/host/" are stored as "" and "/host"
+	while (!root.empty() && root.back() == '/')
+		root.pop_back();
+
+	fsroot = root;
+}
+
+// Returns empty string for the running system's root
+string get_fsroot()
+{
+	return fsroot;
+}
+
+// Prefix an absolute path with the root
+string fsroot_path(string path)
+{
+	return fsroot + path;
+}
@@ -0,0 +1,11 @@
+/* fsroot
+ *
+ * Root of the queried /sys and /proc filesystems
+ * header file
+ */
+
+#include <string>
+
+void set_fsroot(std::string root);
+std::string get_fsroot();
+std::string fsroot_path(std::string path);
@@ -0,0 +1,95 @@
+/* hugepage-query
+ *
+ * Query hugepages of NUMA nodes
+ *
+ * /sys/devices/system/node/nodeN/hugepages/hugepages-<size>kB/
+ *   nr_hugepages, free_hugepages
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/regex.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "fsroot.hpp"
+#include "hugepage-query.hpp"
+
+namespace fs = boost::filesystem;
+
+using namespace std;
+
+static int read_count(unsigned long &count, fs::path p)
+{
+	if (!fs::exists(p) || !fs::is_regular_file(p))
+		return 1;
+
+	try {
+		fs::ifstream fin(p);
+		fin >> count;
+		fin.close();
+	} catch (...) {
+		return 1;
+	}
+
+	return 0;
+}
+
+// Return NUMA nodes present in sysfs
+vector<unsigned int> get_numa_nodes()
+{
+	vector<unsigned int> nodes;
+
+	fs::path p(fsroot_path("/sys/devices/system/node/"));
+	if (fs::exists(p) && fs::is_directory(p))
+	{
+		static const boost::regex pattern("^node([0-9]+)$");
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(p), {}))
+		{
+			boost::smatch match;
+			string fn = entry.path().filename().string();
+			if (boost::regex_match(fn, match, pattern))
+				nodes.push_back(stoul(match[1]));
+		}
+	}
+
+	sort(nodes.begin(), nodes.end());
+	return nodes;
+}
+
+// Return hugepage pools of a NUMA node, ordered by page size
+vector<HUGEPAGES> get_numa_hugepages(unsigned int node)
+{
+	vector<HUGEPAGES> pools;
+
+	fs::path p(fsroot_path("/sys/devices/system/node/node" +
+		to_string(node) + "/hugepages/"));
+	if (fs::exists(p) && fs::is_directory(p))
+	{
+		static const boost::regex pattern("^hugepages-([0-9]+)kB$");
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(p), {}))
+		{
+			boost::smatch match;
+			string fn = entry.path().filename().string();
+			if (!boost::regex_match(fn, match, pattern))
+				continue;
+
+			HUGEPAGES pool;
+			pool.size_kb = stoul(match[1]);
+			if (read_count(pool.total, entry.path() / "nr_hugepages") ||
+				read_count(pool.free, entry.path() / "free_hugepages"))
+				continue;
+
+			pools.push_back(pool);
+		}
+	}
+
+	sort(pools.begin(), pools.end(),
+		[](const HUGEPAGES &a, const HUGEPAGES &b)
+		{
+			return a.size_kb < b.size_kb;
+		});
+	return pools;
+}
@@ -0,0 +1,17 @@
+/* hugepage-query
+ *
+ * Query hugepages of NUMA nodes
+ * header file
+ */
+
+#include <vector>
+
+struct HUGEPAGES
+{
+	unsigned long size_kb;
+	unsigned long total;
+	unsigned long free;
+};
+
+std::vector<unsigned int> get_numa_nodes();
+std::vector<HUGEPAGES> get_numa_hugepages(unsigned int node);
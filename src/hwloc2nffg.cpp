@@ -9,18 +9,35 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <algorithm>
+#include <set>
+#include <vector>
 #include <unordered_set>
+#include <tuple>
+#include <limits>
+#include <thread>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <jsoncpp/json/json.h>
 #include <hwloc.h>
 #include <sys/utsname.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "dpdk-query.hpp"
 #include "interface-query.hpp"
+#include "utilization-query.hpp"
+#include "irq-query.hpp"
+#include "cpu-query.hpp"
+#include "fingerprint.hpp"
+#include "fsroot.hpp"
+#include "hugepage-query.hpp"
 
 using namespace std;
 
@@ -30,6 +47,9 @@ namespace po = boost::program_options;
 const string version = "unknown";
 
 const unsigned long INTERFACE_SPEED_DEFAULT = 1001;
+
+// Exit status if the cached output is still valid (--notmodified)
+const int EXIT_NOT_MODIFIED = 3;
 //int cpusocket = 0;
 
 class ID
@@ -39,6 +59,10 @@ class ID
 
 	public:
 	map<string, unsigned int> lastfreeidfortype;
+	// OS index of the PU behind each EE node
+	map<string, unsigned int> pu_os_index;
+	// Name of the infra node of each emitted object
+	map<hwloc_obj_t, string> node_names;
 
 	unsigned int get_next_id_for_type(string nodetype)
 	{
@@ -58,11 +82,46 @@ class ID
 	}
 };
 
+// SAP injected at a NUMA node (synthetic mode)
+struct FAKE_SAP
+{
+	string name;
+	unsigned int numa;
+	unsigned long speed;
+	bool dpdk;
+};
+
 struct OPTIONS
 {
 	bool merge = false;
 	bool dpdk = false;
 	bool notreported = false;
+	bool irq = false;
+	bool llcgroups = false;
+	bool cpuflags = false;
+	bool isolatedonly = false;
+	bool pathmetrics = false;
+	bool stacking = false;
+	bool hugepages = false;
+	unsigned int nearest = 0;
+	bool overlay = false;
+	unsigned int interval = 1;
+	unsigned int count = 1;
+	string cache;
+	bool notmodified = false;
+	string synthetic;
+	vector<FAKE_SAP> fakesaps;
+	string hostroot;
+	// "host": all PUs of the host, "cgroup": only the allowed PUs
+	string cpuset;
+};
+
+// Output built from the same discovery with its own options
+struct VIEW
+{
+	string name;
+	OPTIONS options;
+	string path;
 };
 
 string get_link_speed(string dev_name)
@@ -89,13 +148,40 @@ string get_link_speed(string dev_name)
 	return to_string(INTERFACE_SPEED_DEFAULT);
 }
 
-void add_parameters(Json::Value &root)
+// Link speed of a SAP, injected SAPs have their own speed
+string get_link_speed(string dev_name, OPTIONS &options)
+{
+	for (auto &fake: options.fakesaps)
+		if (fake.name == dev_name)
+			return to_string(fake.speed);
+
+	return get_link_speed(dev_name);
+}
+
+// Host name of the queried host, not of the container
+string get_host_name()
 {
 	struct utsname unamedata;
 	uname(&unamedata);
+	string nodename = unamedata.nodename;
+
+	if (!get_fsroot().empty())
+	{
+		ifstream fin(fsroot_path("/proc/sys/kernel/hostname"));
+		string hostname;
+		if (getline(fin, hostname) && !hostname.empty())
+			nodename = hostname;
+	}
 
-	root["id"] = unamedata.nodename;
-	root["name"] = string("NFFG-") + string(unamedata.nodename);
+	return nodename;
+}
+
+void add_parameters(Json::Value &root)
+{
+	string nodename = get_host_name();
+
+	root["id"] = nodename;
+	root["name"] = string("NFFG-") + nodename;
 
 	// TODO: real versioning
 	root["version"] = "1.0";
@@ -140,13 +226,38 @@ bool dpdk_sap(hwloc_obj_t node, OPTIONS &options)
 	return false;
 }
 
+// Check if the CPU state (cpu_init()) is used
+bool uses_cpu_state(OPTIONS &options)
+{
+	return options.cpuflags || options.isolatedonly || !options.cpuset.empty();
+}
+
+// Check if a PU is reported as an EE
+bool reported_pu(unsigned int os_index, OPTIONS &options)
+{
+	if (!uses_cpu_state(options))
+		return true;
+
+	if (options.cpuset == "cgroup" && !is_allowed_cpu(os_index))
+		return false;
+
+	if (!is_online_cpu(os_index))
+		return false;
+
+	// Housekeeping CPUs are excluded
+	if (options.isolatedonly)
+		return is_isolated_cpu(os_index) || is_nohz_full_cpu(os_index);
+
+	return true;
+}
+
 // Check if node is required (based on node's type)
 bool required_by_type(hwloc_obj_t node, OPTIONS &options)
 {
 	hwloc_obj_type_t type = node->type;
 
 	if (type == HWLOC_OBJ_PU)
-		return true;
+		return reported_pu(node->os_index, options);
 	else if (type == HWLOC_OBJ_OS_DEVICE)
 		return network_sap(node);
 	else if (type == HWLOC_OBJ_PCI_DEVICE)
@@ -199,8 +310,191 @@ string get_node_name(hwloc_obj_t obj, ID &id, OPTIONS &options)
 		return sanitize(type + "!" + to_string(id.get_next_id_for_type(type)));
 }
 
+// Name of the EE node of a PU (same as get_node_name() gives)
+string pu_node_name(unsigned int os_index)
+{
+	return sanitize("PU#" + to_string(os_index));
+}
+
+Json::Value pu_node_names(const set<unsigned int> &cpus, OPTIONS &options)
+{
+	Json::Value names(Json::arrayValue);
+	for (auto cpu: cpus)
+		if (reported_pu(cpu, options))
+			names.append(pu_node_name(cpu));
+	return names;
+}
+
+// Names of the EE nodes of a cpuset
+Json::Value cpuset_node_names(hwloc_const_cpuset_t cpuset, OPTIONS &options)
+{
+	set<unsigned int> cpus;
+	unsigned int cpu;
+
+	hwloc_bitmap_foreach_begin(cpu, cpuset)
+		cpus.insert(cpu);
+	hwloc_bitmap_foreach_end();
+
+	return pu_node_names(cpus, options);
+}
+
+// Cache attributes with the EEs sharing the cache
+Json::Value get_cache_attributes(hwloc_obj_t obj, OPTIONS &options)
+{
+	Json::Value cache;
+	cache["level"] = obj->attr->cache.depth;
+	cache["size"] = (Json::UInt64)obj->attr->cache.size;
+	cache["linesize"] = obj->attr->cache.linesize;
+	cache["associativity"] = obj->attr->cache.associativity;
+
+	switch (obj->attr->cache.type)
+	{
+		case HWLOC_OBJ_CACHE_DATA:
+			cache["type"] = "data";
+			break;
+		case HWLOC_OBJ_CACHE_INSTRUCTION:
+			cache["type"] = "instruction";
+			break;
+		default:
+			cache["type"] = "unified";
+			break;
+	}
+
+	cache["sharing"] = cpuset_node_names(obj->cpuset, options);
+	return cache;
+}
+
+// Add last level cache domains as placement groups
+void add_llc_groups(
+	Json::Value &root, hwloc_topology_t &topology, OPTIONS &options)
+{
+	vector<hwloc_obj_t> llcs;
+
+	hwloc_obj_t pu = NULL;
+	while ((pu = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_PU, pu)))
+	{
+		// Highest level cache above the PU
+		hwloc_obj_t llc = NULL;
+		for (hwloc_obj_t p = pu->parent; p; p = p->parent)
+			if (p->type == HWLOC_OBJ_CACHE &&
+				(!llc || p->attr->cache.depth > llc->attr->cache.depth))
+				llc = p;
+
+		if (llc && find(llcs.begin(), llcs.end(), llc) == llcs.end())
+			llcs.push_back(llc);
+	}
+
+	Json::Value groups(Json::arrayValue);
+	for (unsigned int i = 0; i < llcs.size(); i++)
+	{
+		Json::Value members = cpuset_node_names(llcs[i]->cpuset, options);
+		if (members.empty())
+			continue;
+
+		Json::Value group;
+		group["id"] = "LLC!" + to_string(i);
+		group["type"] = "LLC";
+		group["level"] = llcs[i]->attr->cache.depth;
+		group["size"] = (Json::UInt64)llcs[i]->attr->cache.size;
+		group["members"] = members;
+		groups.append(group);
+	}
+
+	root["placement_groups"] = groups;
+}
+
+// Add the EEs which service the SAP's queues and interrupts
+void add_queue_affinity(Json::Value &sap, string iface, OPTIONS &options)
+{
+	Json::Value queues(Json::arrayValue);
+	for (auto q: get_queue_affinity(iface))
+	{
+		Json::Value queue;
+		queue["queue"] = q.first;
+		queue["ees"] = pu_node_names(q.second, options);
+		queues.append(queue);
+	}
+	sap["queues"] = queues;
+
+	Json::Value irqs(Json::arrayValue);
+	for (auto i: get_irq_affinity(iface))
+	{
+		Json::Value irq;
+		irq["irq"] = i.first;
+		irq["ees"] = pu_node_names(i.second, options);
+		irqs.append(irq);
+	}
+	sap["irqs"] = irqs;
+}
+
+// Mark isolated/nohz_full PUs and tag them with their physical core
+void add_cpu_attributes(Json::Value &node, hwloc_obj_t obj, OPTIONS &options)
+{
+	node["isolated"] = is_isolated_cpu(obj->os_index);
+	node["nohz_full"] = is_nohz_full_cpu(obj->os_index);
+
+	hwloc_obj_t core = obj->parent;
+	while (core && core->type != HWLOC_OBJ_CORE)
+		core = core->parent;
+
+	// The Core node name is added by add_core_names() (cores are
+	// named after their PUs)
+	if (core)
+	{
+		node["core_os_index"] = core->os_index;
+
+		hwloc_cpuset_t siblings = hwloc_bitmap_dup(core->cpuset);
+		hwloc_bitmap_clr(siblings, obj->os_index);
+		node["smt_siblings"] = cpuset_node_names(siblings, options);
+		hwloc_bitmap_free(siblings);
+	}
+}
+
+// Tag EEs with the name of their Core node (if it is emitted,
+// with --merge a Core with a single PU is not)
+void add_core_names(
+	Json::Value &node_infras, ID &id, hwloc_topology_t &topology)
+{
+	for (auto i = node_infras.begin(); i != node_infras.end(); ++i)
+	{
+		auto pu = id.pu_os_index.find((*i)["id"].asString());
+		if (pu == id.pu_os_index.end())
+			continue;
+
+		hwloc_obj_t core = hwloc_get_pu_obj_by_os_index(topology, pu->second);
+		while (core && core->type != HWLOC_OBJ_CORE)
+			core = core->parent;
+
+		if (core && id.node_names.count(core))
+			(*i)["core"] = id.node_names[core];
+	}
+}
+
 typedef deque<pair<unsigned int, string>*> NodePorts;
 
+// Add a SAP reached through a phantom port of the current node
+void add_phantom_sap(
+	deque<NodePorts*> *allports,
+	Json::Value &node_saps,
+	ID &id,
+	string nname)
+{
+	unsigned int pgid = id.get_next_global_id();
+	auto *nports = new NodePorts;
+	nports->push_back(new pair<unsigned int, string>(pgid, nname));
+	allports->push_back(nports);
+
+	Json::Value sap;
+	Json::Value ports;
+	Json::Value portsid;
+	portsid["id"] = pgid;
+	ports.append(portsid);
+
+	sap["id"] = sap["name"] = nname;
+	sap["ports"] = ports;
+	node_saps.append(sap);
+}
+
 void merge_with_child(NodePorts *ports, hwloc_obj_t obj)
 {
 	// TODO: merging logic
@@ -218,10 +512,10 @@ void add_not_reported_network_interfaces(
 	Json::Value &node_edges,
 	ID &id,
 	unsigned int root_port_id,
-	string &root_node_name)
+	string &root_node_name,
+	unordered_set<string> ifaces,
+	OPTIONS &options)
 {
-	unordered_set<string> ifaces = get_list_of_interfaces();
-
 	for (auto i = node_saps.begin(); i != node_saps.end(); ++i)
 	{
 		Json::FastWriter fastWriter;
@@ -236,6 +530,16 @@ void add_not_reported_network_interfaces(
 		}
 	}
 
+	// Stacked interfaces are added by add_stacked_network_interfaces()
+	if (options.stacking)
+	{
+		for (auto i = ifaces.begin(); i != ifaces.end(); )
+			if (!get_lower_interfaces(*i).empty())
+				i = ifaces.erase(i);
+			else
+				++i;
+	}
+
 	// Now ifaces only contains not reported network interfaces
 
 	if(ifaces.size()<1)
@@ -268,6 +572,8 @@ void add_not_reported_network_interfaces(
 		sap_ports.append(sap_portsid);
 		sap["id"] = sap["name"] = iface;
 		sap["ports"] = sap_ports;
+		if (options.irq)
+			add_queue_affinity(sap, iface, options);
 		node_saps.append(sap);
 
 		// Add a port to nrbus ports
@@ -310,6 +616,422 @@ void add_not_reported_network_interfaces(
 	node_infras.append(nrbus);
 }
 
+// Name of the infra node standing for an object: the object's own node,
+// or if it was merged, the node of its single-child descendants, or
+// else the nearest emitted ancestor (or the node the root was merged
+// into)
+string get_emitted_node_name(hwloc_obj_t obj, ID &id)
+{
+	for (hwloc_obj_t o = obj; o; o = o->arity == 1 ? o->children[0] : NULL)
+		if (id.node_names.count(o))
+			return id.node_names[o];
+
+	hwloc_obj_t top = obj;
+	for (hwloc_obj_t o = obj->parent; o; o = o->parent)
+	{
+		if (id.node_names.count(o))
+			return id.node_names[o];
+		top = o;
+	}
+
+	// Every ancestor was merged into a single-child chain from the root
+	for (hwloc_obj_t o = top; o; o = o->arity == 1 ? o->children[0] : NULL)
+		if (id.node_names.count(o))
+			return id.node_names[o];
+
+	return "";
+}
+
+// Add hugepage pools of each NUMA node (per page size) to the resources
+// of the node standing for it
+//
+// A merged NUMA node gives its pools to its descendant, and NUMA nodes
+// without an hwloc object (single node hosts) give them to the root.
+void add_hugepage_resources(
+	Json::Value &node_infras, ID &id, hwloc_topology_t &topology)
+{
+	map<string, unsigned int> infra_index;
+	for (unsigned int i = 0; i < node_infras.size(); i++)
+		infra_index[node_infras[i]["id"].asString()] = i;
+
+	for (auto numa: get_numa_nodes())
+	{
+		hwloc_obj_t obj = NULL;
+		while ((obj = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_NODE, obj)))
+			if (obj->os_index == numa)
+				break;
+
+		string node_name = get_emitted_node_name(
+			obj ? obj : hwloc_get_root_obj(topology), id);
+		if (!infra_index.count(node_name))
+			continue;
+
+		Json::Value &res = node_infras[infra_index[node_name]]["resources"];
+		if (!res.isMember("hugepages"))
+			res["hugepages"] = Json::Value(Json::arrayValue);
+
+		for (auto &hp: get_numa_hugepages(numa))
+		{
+			Json::Value pool;
+			pool["numa"] = numa;
+			pool["pagesize"] = (Json::UInt64)hp.size_kb;
+			pool["total"] = (Json::UInt64)hp.total;
+			pool["free"] = (Json::UInt64)hp.free;
+			res["hugepages"].append(pool);
+		}
+	}
+}
+
+// Add a port to an infra node
+unsigned int add_infra_port(Json::Value &node, ID &id)
+{
+	unsigned int port_gid = id.get_next_global_id();
+	Json::Value portid;
+	portid["id"] = port_gid;
+	node["ports"].append(portid);
+	return port_gid;
+}
+
+void add_edge(
+	Json::Value &node_edges,
+	ID &id,
+	string src_node,
+	unsigned int src_port,
+	string dst_node,
+	unsigned int dst_port,
+	unsigned long bandwidth)
+{
+	Json::Value edge;
+	edge["id"] = id.get_next_global_id();
+	edge["src_node"] = src_node;
+	edge["src_port"] = src_port;
+	edge["dst_node"] = dst_node;
+	edge["dst_port"] = dst_port;
+	edge["delay"] = 0.1;
+	edge["bandwidth"] = to_string(bandwidth);
+	node_edges.append(edge);
+}
+
+// Aggregated bandwidth of a (logical) interface
+//
+// Bonds sum their members, other logical interfaces (e.g. bridges,
+// VLANs) have the bandwidth of their fastest lower interface, as bridge
+// ports are not aggregated links.
+unsigned long get_stacked_speed(
+	string iface,
+	map<string, unsigned long> &speeds,
+	OPTIONS &options)
+{
+	auto known = speeds.find(iface);
+	if (known != speeds.end())
+		return known->second;
+
+	// Guard against loops
+	speeds[iface] = 0;
+
+	vector<string> lowers = get_lower_interfaces(iface);
+	unsigned long speed = 0;
+
+	if (lowers.empty())
+	{
+		speed = stoul(get_link_speed(iface, options));
+	}
+	else
+	{
+		string kind = get_interface_kind(iface);
+		bool sum = kind == "bond";
+		for (auto lower: lowers)
+		{
+			unsigned long lower_speed = get_stacked_speed(lower, speeds, options);
+			speed = sum ? speed + lower_speed : max(speed, lower_speed);
+		}
+	}
+
+	speeds[iface] = speed;
+	return speed;
+}
+
+// Lowest common ancestor of nodes in the tree (empty if none)
+string get_common_ancestor(
+	const vector<string> &nodes, map<string, string> &parent)
+{
+	if (nodes.empty())
+		return "";
+
+	// Ancestors (inclusive) of the first node, nearest first
+	vector<string> chain;
+	for (string n = nodes[0]; !n.empty();
+		n = parent.count(n) ? parent[n] : "")
+		chain.push_back(n);
+
+	// Keep the part of the chain which is above every other node
+	size_t lowest = 0;
+	for (unsigned int i = 1; i < nodes.size(); i++)
+	{
+		string n = nodes[i];
+		for (; !n.empty(); n = parent.count(n) ? parent[n] : "")
+		{
+			auto found = find(chain.begin() + lowest, chain.end(), n);
+			if (found != chain.end())
+			{
+				lowest = found - chain.begin();
+				break;
+			}
+		}
+		if (n.empty())
+			return "";
+	}
+
+	return chain[lowest];
+}
+
+// Add a logical interface (and the logical interfaces it is stacked on)
+void add_stacked_network_interface(
+	string iface,
+	Json::Value &node_infras,
+	Json::Value &node_saps,
+	Json::Value &node_edges,
+	ID &id,
+	string &root_node_name,
+	const set<string> &logical,
+	map<string, unsigned int> &infra_index,
+	map<string, string> &parent,
+	map<string, unsigned long> &speeds,
+	OPTIONS &options)
+{
+	string stack_name = "STACK!" + iface;
+	if (infra_index.count(stack_name))
+		return;
+
+	// Guard against loops
+	infra_index[stack_name] = 0;
+
+	// Nodes the members are attached to
+	vector<string> anchors;
+	Json::Value members(Json::arrayValue);
+	for (auto lower: get_lower_interfaces(iface))
+	{
+		string anchor;
+		if (logical.count(lower))
+		{
+			add_stacked_network_interface(lower, node_infras, node_saps,
+				node_edges, id, root_node_name, logical, infra_index, parent,
+				speeds, options);
+			anchor = "STACK!" + lower;
+		}
+		else if (parent.count(lower) && infra_index.count(parent[lower]))
+		{
+			anchor = parent[lower];
+		}
+		else
+			continue;
+
+		// Loop member
+		if (!parent.count(anchor) && anchor != root_node_name)
+			continue;
+
+		members.append(lower);
+		if (find(anchors.begin(), anchors.end(), anchor) == anchors.end())
+			anchors.push_back(anchor);
+	}
+
+	// Hang off the common ancestor of the members, so the graph stays a
+	// tree (no transit path between the members through the switch)
+	string anchor = get_common_ancestor(anchors, parent);
+	if (anchor.empty() || !infra_index.count(anchor))
+		anchor = root_node_name;
+	if (!infra_index.count(anchor))
+	{
+		infra_index.erase(stack_name);
+		return;
+	}
+
+	Json::Value stack;
+	stack["id"] = stack["name"] = stack_name;
+	stack["domain"] = "INTERNAL";
+	stack["type"] = "SDN-SWITCH";
+	stack["kind"] = get_interface_kind(iface);
+	stack["members"] = members;
+	stack["ports"] = Json::Value(Json::arrayValue);
+	Json::Value res;
+	res["cpu"] = 0;
+	res["mem"] = 0;
+	res["storage"] = 0;
+	res["delay"] = 0.5;
+	res["bandwidth"]= 1000;
+	stack["resources"] = res;
+
+	infra_index[stack_name] = node_infras.size();
+	node_infras.append(stack);
+	parent[stack_name] = anchor;
+
+	unsigned long speed = get_stacked_speed(iface, speeds, options);
+
+	Json::Value &anchor_node = node_infras[infra_index[anchor]];
+	unsigned int src_port = add_infra_port(anchor_node, id);
+	unsigned int dst_port = add_infra_port(node_infras[infra_index[stack_name]], id);
+	add_edge(node_edges, id, anchor, src_port, stack_name, dst_port, speed);
+
+	// Add the logical SAP
+	unsigned int sap_port_id = id.get_next_global_id();
+	Json::Value sap;
+	Json::Value sap_ports;
+	Json::Value sap_portsid;
+	sap_portsid["id"] = sap_port_id;
+	sap_ports.append(sap_portsid);
+	sap["id"] = sap["name"] = iface;
+	sap["ports"] = sap_ports;
+	node_saps.append(sap);
+	parent[iface] = stack_name;
+
+	unsigned int stack_port = add_infra_port(node_infras[infra_index[stack_name]], id);
+	add_edge(node_edges, id, stack_name, stack_port, iface, sap_port_id, speed);
+}
+
+// Add logical interfaces (bonds, bridges, VLANs etc.) with their members
+//
+// Each logical interface gets a SAP behind its own STACK!<iface> switch,
+// which lists the members and has the aggregated bandwidth. The switch
+// hangs off the common ancestor of the nodes its members are attached
+// to (a logical member's own switch counts as its node), so the graph
+// stays a tree. Logical interfaces without any member in the graph are
+// connected to the root node.
+void add_stacked_network_interfaces(
+	Json::Value &node_infras,
+	Json::Value &node_saps,
+	Json::Value &node_edges,
+	ID &id,
+	string &root_node_name,
+	const unordered_set<string> &ifaces,
+	OPTIONS &options)
+{
+	// Logical interfaces in stable order
+	set<string> logical;
+	for (auto iface: ifaces)
+		if (!get_lower_interfaces(iface).empty())
+			logical.insert(iface);
+
+	if (logical.empty())
+		return;
+
+	map<string, unsigned int> infra_index;
+	for (unsigned int i = 0; i < node_infras.size(); i++)
+		infra_index[node_infras[i]["id"].asString()] = i;
+
+	// Edges point from parent to child
+	map<string, string> parent;
+	for (auto i = node_edges.begin(); i != node_edges.end(); ++i)
+		parent[(*i)["dst_node"].asString()] = (*i)["src_node"].asString();
+
+	map<string, unsigned long> speeds;
+
+	for (auto iface: logical)
+		add_stacked_network_interface(iface, node_infras, node_saps,
+			node_edges, id, root_node_name, logical, infra_index, parent,
+			speeds, options);
+}
+
+// Add a PCI device of an injected SAP, the SAP hangs off it
+//
+// Same as the PCI device node of a discovered SAP, but named by a bus id
+// in the unused ffff domain.
+void add_fake_pci_device(
+	deque<NodePorts*> *allports,
+	Json::Value &node_infras,
+	Json::Value &node_saps,
+	Json::Value &node_edges,
+	ID &id,
+	FAKE_SAP &fake,
+	unsigned int n,
+	OPTIONS &options)
+{
+	char busid[32];
+	snprintf(busid, sizeof(busid), "ffff:%02x:%02x.0", fake.numa, n);
+	string node_name = busid;
+
+	deque<NodePorts*> sapports;
+	add_phantom_sap(&sapports, node_saps, id, fake.name);
+
+	Json::Value ports;
+	for (auto sp: sapports)
+	{
+		for (auto pit = sp->begin(); pit != sp->end(); pit++)
+		{
+			Json::Value edge;
+			unsigned int port_gid;
+
+			edge["id"] = id.get_next_global_id();
+			edge["src_node"] = node_name;
+			port_gid = id.get_next_global_id();
+			edge["src_port"] = port_gid;
+			edge["dst_node"] = (*pit)->second;
+			edge["dst_port"] = (*pit)->first;
+			edge["delay"] = 0.1;
+			edge["bandwidth"] = get_link_speed((*pit)->second, options);
+			node_edges.append(edge);
+
+			Json::Value portid;
+			portid["id"] = port_gid;
+			ports.append(portid);
+		}
+	}
+
+	Json::Value portid;
+	unsigned int port_gid = id.get_next_global_id();
+	portid["id"] = port_gid;
+	ports.append(portid);
+
+	Json::Value node;
+	node["id"] = node["name"] = node_name;
+	node["ports"] = ports;
+	node["domain"] = "INTERNAL";
+	node["type"] = "SDN-SWITCH";
+	Json::Value res;
+	res["cpu"] = 0;
+	res["mem"] = 0;
+	res["storage"] = 0;
+	res["delay"] = 0.5;
+	res["bandwidth"]= 1000;
+	node["resources"] = res;
+	node_infras.append(node);
+
+	auto *node_ports = new NodePorts;
+	node_ports->push_back(new pair<unsigned int, string>(port_gid, node_name));
+	allports->push_back(node_ports);
+}
+
+// Add ports of SAPs injected at a NUMA node
+//
+// Every SAP gets its own PCI device, like a discovered one. With --merge
+// the PCI device of a network SAP is merged (it has one child), but a
+// DPDK PCI device has no child and stays.
+void add_fake_saps(
+	deque<NodePorts*> *allports,
+	Json::Value &node_infras,
+	Json::Value &node_saps,
+	Json::Value &node_edges,
+	ID &id,
+	hwloc_obj_t obj,
+	OPTIONS &options)
+{
+	if (obj->type != HWLOC_OBJ_NODE)
+		return;
+
+	unsigned int n = 0;
+	for (auto &fake: options.fakesaps)
+	{
+		if (fake.numa != obj->os_index)
+			continue;
+
+		if (options.merge && !fake.dpdk)
+			add_phantom_sap(allports, node_saps, id, fake.name);
+		else
+			add_fake_pci_device(allports, node_infras, node_saps,
+				node_edges, id, fake, n, options);
+		n++;
+	}
+}
+
 // Process nodes
 NodePorts *add_nodes(
 	Json::Value &node_infras,
@@ -329,6 +1051,18 @@ NodePorts *add_nodes(
 		auto *ports = add_nodes(node_infras, node_saps,
 			node_edges, id, topology, obj->children[0], depth + 1, options);
 		merge_with_child(ports, obj);
+
+		// SAPs injected at a merged NUMA node hang off its parent
+		deque<NodePorts*> fakeports;
+		add_fake_saps(&fakeports, node_infras, node_saps, node_edges, id,
+			obj, options);
+		for (auto fp: fakeports)
+		{
+			if (ports == NULL)
+				ports = new NodePorts;
+			ports->insert(ports->end(), fp->begin(), fp->end());
+		}
+
 		return ports;
 	}
 
@@ -342,23 +1076,14 @@ NodePorts *add_nodes(
     // Add phantom port in case of DPDK
     if (dpdk_sap(obj, options))
     {
-		unsigned int pgid = id.get_next_global_id();
-		string nname = get_dpdk_interface_name(busid_from_pcidev(obj));
-		auto *nports = new NodePorts;
-		nports->push_back(new pair<unsigned int, string>(pgid, nname));
-		allports->push_back(nports);
-
-		Json::Value sap;
-		Json::Value ports;
-		Json::Value portsid;
-		portsid["id"] = pgid;
-		ports.append(portsid);
-
-		sap["id"] = sap["name"] = nname;
-		sap["ports"] = ports;
-		node_saps.append(sap);
+		add_phantom_sap(allports, node_saps, id,
+			get_dpdk_interface_name(busid_from_pcidev(obj)));
 	}
 
+	// Add phantom ports of SAPs injected at this NUMA node
+	add_fake_saps(allports, node_infras, node_saps, node_edges, id, obj,
+		options);
+
     if (!allports->empty() || required_by_type(obj, options))
     {
 		Json::Value node;
@@ -383,7 +1108,7 @@ NodePorts *add_nodes(
 					edge["dst_node"] = (*pit)->second;
 					edge["dst_port"] = (*pit)->first;
 					edge["delay"] = 0.1;
-					edge["bandwidth"] = get_link_speed((*pit)->second);
+					edge["bandwidth"] = get_link_speed((*pit)->second, options);
 					node_edges.append(edge);
 
 					Json::Value portid;
@@ -403,6 +1128,8 @@ NodePorts *add_nodes(
 			Json::Value sap;
 			sap["id"] = sap["name"] = node_name;
 			sap["ports"] = ports;
+			if (options.irq)
+				add_queue_affinity(sap, node_name, options);
 			node_saps.append(sap);
 		}
 		else
@@ -414,6 +1141,9 @@ NodePorts *add_nodes(
 
 			if (obj->type == HWLOC_OBJ_PU)
 			{
+				id.pu_os_index[node_name] = obj->os_index;
+				if (options.cpuflags)
+					add_cpu_attributes(node, obj, options);
 				Json::Value supported;
 				supported.append("headerDecompressor");
 				node["type"] = "EE";
@@ -429,6 +1159,8 @@ NodePorts *add_nodes(
 			else
 			{
 				node["type"] = "SDN-SWITCH";
+				if (obj->type == HWLOC_OBJ_CACHE)
+					node["cache"] = get_cache_attributes(obj, options);
 				Json::Value res;
 				res["cpu"] = 0;
 				res["mem"] = 0;
@@ -438,6 +1170,7 @@ NodePorts *add_nodes(
 				node["resources"] = res;
 			}
 			node_infras.append(node);
+			id.node_names[obj] = node_name;
 		}
 
 		auto *node_ports = new NodePorts;
@@ -449,45 +1182,661 @@ NodePorts *add_nodes(
 	return NULL;
 }
 
-void add_topology_tree(Json::Value &root, OPTIONS &options)
+// Numeric value of a JSON number or numeric string
+double json_number(const Json::Value &v)
 {
-	if(options.dpdk)
+	if (v.isString())
+		return stod(v.asString());
+	return v.asDouble();
+}
+
+struct PATH_METRIC
+{
+	unsigned int hops;
+	double delay;
+	double bandwidth;
+	string ee;
+};
+
+// Add hop count, delay and bottleneck bandwidth of every SAP->EE path
+//
+// The graph is a tree, so one traversal from each SAP visits every EE
+// on its only path. Delay sums the links and the intermediate nodes,
+// bandwidth is the minimum of them. EEs are ranked by delay, then hops.
+void add_path_metrics(Json::Value &root, OPTIONS &options)
+{
+	map<string, unsigned int> index;
+	vector<string> names;
+	vector<bool> is_ee, is_sap;
+	vector<double> node_delay, node_bandwidth;
+
+	auto add_node = [&](const Json::Value &node, bool ee, bool sap)
 	{
-		dpdk_init();
+		index[node["id"].asString()] = names.size();
+		names.push_back(node["id"].asString());
+		is_ee.push_back(ee);
+		is_sap.push_back(sap);
+		const Json::Value &res = node["resources"];
+		node_delay.push_back(res.isMember("delay") ?
+			json_number(res["delay"]) : 0);
+		node_bandwidth.push_back(res.isMember("bandwidth") ?
+			json_number(res["bandwidth"]) : numeric_limits<double>::max());
+	};
+
+	const Json::Value &node_infras = root["node_infras"];
+	for (auto i = node_infras.begin(); i != node_infras.end(); ++i)
+		add_node(*i, (*i)["type"].asString() == "EE", false);
+
+	const Json::Value &node_saps = root["node_saps"];
+	for (auto i = node_saps.begin(); i != node_saps.end(); ++i)
+		add_node(*i, false, true);
+
+	// Adjacency: (neighbour, delay, bandwidth) of links
+	vector<vector<tuple<unsigned int, double, double>>> adj(names.size());
+	const Json::Value &node_edges = root["edge_links"];
+	for (auto i = node_edges.begin(); i != node_edges.end(); ++i)
+	{
+		auto src = index.find((*i)["src_node"].asString());
+		auto dst = index.find((*i)["dst_node"].asString());
+		if (src == index.end() || dst == index.end())
+			continue;
+
+		double delay = json_number((*i)["delay"]);
+		double bandwidth = json_number((*i)["bandwidth"]);
+		adj[src->second].push_back(make_tuple(dst->second, delay, bandwidth));
+		adj[dst->second].push_back(make_tuple(src->second, delay, bandwidth));
 	}
 
-	hwloc_topology_t topology;
+	Json::Value path_metrics(Json::arrayValue);
+	vector<PATH_METRIC> reached(names.size());
+	vector<bool> visited(names.size());
+
+	for (unsigned int sap = 0; sap < names.size(); sap++)
+	{
+		if (!is_sap[sap])
+			continue;
+
+		vector<PATH_METRIC> metrics;
+		fill(visited.begin(), visited.end(), false);
+		reached[sap] = { 0, 0, numeric_limits<double>::max(), "" };
+		visited[sap] = true;
+
+		vector<unsigned int> stack(1, sap);
+		while (!stack.empty())
+		{
+			unsigned int u = stack.back();
+			stack.pop_back();
+
+			// Paths continue only through infra nodes
+			if (u != sap && is_sap[u])
+				continue;
+
+			for (auto &e: adj[u])
+			{
+				unsigned int v = get<0>(e);
+				if (visited[v])
+					continue;
+				visited[v] = true;
+
+				PATH_METRIC &m = reached[v];
+				m = reached[u];
+				m.hops++;
+				m.delay += get<1>(e);
+				m.bandwidth = min(m.bandwidth, get<2>(e));
+				if (u != sap)
+				{
+					m.delay += node_delay[u];
+					m.bandwidth = min(m.bandwidth, node_bandwidth[u]);
+				}
+
+				if (is_ee[v])
+				{
+					m.ee = names[v];
+					metrics.push_back(m);
+				}
+				stack.push_back(v);
+			}
+		}
+
+		sort(metrics.begin(), metrics.end(),
+			[](const PATH_METRIC &a, const PATH_METRIC &b)
+			{
+				if (a.delay != b.delay)
+					return a.delay < b.delay;
+				if (a.hops != b.hops)
+					return a.hops < b.hops;
+				return a.ee < b.ee;
+			});
+
+		if (options.nearest && metrics.size() > options.nearest)
+			metrics.resize(options.nearest);
+
+		Json::Value ees(Json::arrayValue);
+		for (auto &m: metrics)
+		{
+			Json::Value ee;
+			ee["ee"] = m.ee;
+			ee["hops"] = m.hops;
+			ee["delay"] = m.delay;
+			ee["bandwidth"] = m.bandwidth;
+			ees.append(ee);
+		}
+
+		Json::Value sap_metrics;
+		sap_metrics["sap"] = names[sap];
+		sap_metrics["ees"] = ees;
+		path_metrics.append(sap_metrics);
+	}
+
+	root["path_metrics"] = path_metrics;
+}
+
+// Check that every injected SAP has its NUMA node
+int check_fake_saps(hwloc_topology_t &topology, OPTIONS &options)
+{
+	for (auto &fake: options.fakesaps)
+	{
+		bool found = false;
+		hwloc_obj_t numa = NULL;
+		while ((numa = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_NODE, numa)))
+			if (numa->os_index == fake.numa)
+				found = true;
+
+		if (!found)
+		{
+			cerr << "No NUMA node " << fake.numa << " for " << fake.name << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Discover the topology
+//
+// Returns
+// 0    success
+// else failed
+int load_topology(hwloc_topology_t &topology, OPTIONS &options)
+{
+	// Discover the (bind-mounted) host instead of the running system
+	if (!options.hostroot.empty())
+		setenv("HWLOC_FSROOT", options.hostroot.c_str(), 1);
 
 	// Allocate and initialize topology object.
 	hwloc_topology_init(&topology);
 
-	// Add PCI devices for detection
-	hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_IO);
+	// Use a synthetic topology instead of the real one
+	if (!options.synthetic.empty() &&
+		hwloc_topology_set_synthetic(topology, options.synthetic.c_str()) < 0)
+	{
+		cerr << "Invalid synthetic topology: " << options.synthetic << endl;
+		return 1;
+	}
+
+	// Add PCI devices for detection, with --cpuset also the PUs
+	// outside of the cgroup (filtered later in "cgroup" mode)
+	unsigned long flags = HWLOC_TOPOLOGY_FLAG_WHOLE_IO;
+	if (!options.cpuset.empty())
+		flags |= HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM;
+	hwloc_topology_set_flags(topology, flags);
 
 	// Perform the topology detection.
 	hwloc_topology_load(topology);
 
+	return check_fake_saps(topology, options);
+}
+
+// Build the NFFG of a discovered topology
+//
+// Only reads the topology and the interface list, so several NFFGs
+// can be built from them in parallel.
+void build_topology_tree(
+	Json::Value &root,
+	ID &id,
+	hwloc_topology_t &topology,
+	const unordered_set<string> &ifaces,
+	OPTIONS &options)
+{
 	// Add NFFG parameters
 	Json::Value parameters;
 	add_parameters(parameters);
 	root["parameters"] = parameters;
 
-	ID id;
 	Json::Value node_infras, node_saps, node_edges;
 
 	NodePorts *np = add_nodes(node_infras, node_saps, node_edges,
 		id, topology, hwloc_get_root_obj(topology), 0, options);
 
-	if(options.notreported)
+	if(options.cpuflags)
+	{
+		add_core_names(node_infras, id, topology);
+	}
+
+	if(options.hugepages)
+	{
+		add_hugepage_resources(node_infras, id, topology);
+	}
+
+	if(options.notreported && np != NULL)
 	{
 		add_not_reported_network_interfaces(
 			node_infras, node_saps, node_edges, id,
-			np->front()->first, np->front()->second);
+			np->front()->first, np->front()->second, ifaces, options);
+	}
+
+	if(options.stacking && np != NULL)
+	{
+		add_stacked_network_interfaces(
+			node_infras, node_saps, node_edges, id,
+			np->front()->second, ifaces, options);
+	}
+
+	if(options.llcgroups)
+	{
+		add_llc_groups(root, topology, options);
 	}
 
 	root["node_saps"] = node_saps;
 	root["node_infras"] = node_infras;
 	root["edge_links"] = node_edges;
+
+	if(options.pathmetrics)
+	{
+		add_path_metrics(root, options);
+	}
+}
+
+// Returns
+// 0    success
+// else failed
+int add_topology_tree(Json::Value &root, ID &id, OPTIONS &options)
+{
+	if(options.dpdk)
+	{
+		dpdk_init();
+	}
+
+	if(uses_cpu_state(options))
+	{
+		cpu_init();
+	}
+
+	hwloc_topology_t topology;
+	if (load_topology(topology, options))
+		return 1;
+
+	build_topology_tree(root, id, topology, get_list_of_interfaces(), options);
+	return 0;
+}
+
+// Synthetic topologies cannot be combined with options reading the
+// running host
+//
+// Returns
+// 0    success
+// else failed
+int check_synthetic_options(OPTIONS &options)
+{
+	if (options.synthetic.empty())
+		return 0;
+
+	vector<string> host_options;
+	if (options.dpdk)
+		host_options.push_back("dpdk");
+	if (options.notreported)
+		host_options.push_back("notreported");
+	if (options.irq)
+		host_options.push_back("irq");
+	if (options.cpuflags)
+		host_options.push_back("cpuflags");
+	if (options.isolatedonly)
+		host_options.push_back("isolatedonly");
+	if (options.stacking)
+		host_options.push_back("stacking");
+	if (options.hugepages)
+		host_options.push_back("hugepages");
+	if (options.overlay)
+		host_options.push_back("overlay");
+	if (!options.hostroot.empty())
+		host_options.push_back("hostroot");
+	if (!options.cpuset.empty())
+		host_options.push_back("cpuset");
+
+	for (auto option: host_options)
+		cerr << "Option " << option << " cannot be used with synthetic" << endl;
+
+	return !host_options.empty();
+}
+
+// Set a flag option of a view
+//
+// Returns
+// 0    success
+// else failed
+int set_view_flag(string flag, OPTIONS &options)
+{
+	if (flag == "merge")
+		options.merge = true;
+	else if (flag == "dpdk")
+		options.dpdk = true;
+	else if (flag == "notreported")
+		options.notreported = true;
+	else if (flag == "irq")
+		options.irq = true;
+	else if (flag == "llcgroups")
+		options.llcgroups = true;
+	else if (flag == "cpuflags")
+		options.cpuflags = true;
+	else if (flag == "isolatedonly")
+		options.isolatedonly = true;
+	else if (flag == "pathmetrics")
+		options.pathmetrics = true;
+	else if (flag == "stacking")
+		options.stacking = true;
+	else if (flag == "hugepages")
+		options.hugepages = true;
+	else
+		return 1;
+
+	return 0;
+}
+
+// Parse "<name>:<flag>[,<flag>...]:<path>", flags add to the
+// command line options
+//
+// Returns
+// 0    success
+// else failed
+int parse_view(string spec, OPTIONS &options, VIEW &view)
+{
+	size_t first = spec.find(':');
+	size_t second = first == string::npos ?
+		string::npos : spec.find(':', first + 1);
+	if (second == string::npos)
+		return 1;
+
+	view.name = spec.substr(0, first);
+	view.path = spec.substr(second + 1);
+	view.options = options;
+	if (view.name.empty() || view.path.empty())
+		return 1;
+
+	vector<string> flags;
+	string flag_list = spec.substr(first + 1, second - first - 1);
+	if (!flag_list.empty())
+		boost::split(flags, flag_list, boost::is_any_of(","));
+
+	for (auto flag: flags)
+		if (set_view_flag(flag, view.options))
+			return 1;
+
+	return 0;
+}
+
+// Discover once and write every view, views are built in parallel
+//
+// Returns
+// 0    success
+// else failed
+int write_views(vector<VIEW> &views, OPTIONS &options)
+{
+	bool dpdk = false, cpu = false;
+	for (auto &view: views)
+	{
+		dpdk |= view.options.dpdk;
+		cpu |= uses_cpu_state(view.options);
+	}
+
+	if (dpdk)
+		dpdk_init();
+	if (cpu)
+		cpu_init();
+
+	hwloc_topology_t topology;
+	if (load_topology(topology, options))
+		return 1;
+
+	const unordered_set<string> ifaces = get_list_of_interfaces();
+
+	vector<int> results(views.size(), 0);
+	vector<thread> threads;
+	for (unsigned int i = 0; i < views.size(); i++)
+	{
+		threads.push_back(thread([&, i]()
+		{
+			Json::Value root;
+			ID id;
+			build_topology_tree(root, id, topology, ifaces, views[i].options);
+
+			Json::StyledWriter writer;
+			ofstream fout(views[i].path);
+			fout << writer.write(root);
+			fout.close();
+			results[i] = !fout;
+		}));
+	}
+
+	int res = 0;
+	for (unsigned int i = 0; i < views.size(); i++)
+	{
+		threads[i].join();
+		if (results[i])
+		{
+			cerr << "Cannot write view " << views[i].name << ": "
+				<< views[i].path << endl;
+			res = 1;
+		}
+	}
+
+	return res;
+}
+
+// Add available capacity (based on the last two utilization samples)
+// to EE nodes and to the links of SAPs
+void add_utilization_overlay(Json::Value &root, ID &id)
+{
+	Json::Value &node_infras = root["node_infras"];
+	for (auto i = node_infras.begin(); i != node_infras.end(); ++i)
+	{
+		auto pu = id.pu_os_index.find((*i)["id"].asString());
+		if (pu == id.pu_os_index.end())
+			continue;
+
+		// Drop values of previous samples if there is no current one
+		double busy = get_cpu_busy(pu->second);
+		if (busy < 0)
+		{
+			(*i).removeMember("available");
+			continue;
+		}
+
+		Json::Value available;
+		available["cpu"] = json_number((*i)["resources"]["cpu"]) * (1 - busy);
+		(*i)["available"] = available;
+	}
+
+	Json::Value &node_edges = root["edge_links"];
+	for (auto i = node_edges.begin(); i != node_edges.end(); ++i)
+	{
+		double mbit, pps;
+		if (get_interface_rate((*i)["dst_node"].asString(), mbit, pps))
+		{
+			(*i).removeMember("load");
+			(*i).removeMember("available");
+			continue;
+		}
+
+		Json::Value load;
+		load["bandwidth"] = mbit;
+		load["packet_rate"] = pps;
+		(*i)["load"] = load;
+
+		Json::Value available;
+		available["bandwidth"] =
+			max(0.0, json_number((*i)["bandwidth"]) - mbit);
+		(*i)["available"] = available;
+	}
+}
+
+// Extra fingerprint input: command line and volatile inputs of options
+string get_fingerprint_extra(int argc, char* argv[], OPTIONS &options)
+{
+	string extra;
+
+	// Cache options do not change the output
+	for (int i = 1; i < argc; i++)
+	{
+		string arg(argv[i]);
+		if (arg == "--cache")
+			i++;
+		else if (arg != "--notmodified" &&
+			!boost::starts_with(arg, "--cache="))
+			extra += arg + '\n';
+	}
+
+	// The host name is the id of the output
+	extra += "host " + get_host_name() + '\n';
+
+	// Queue and IRQ affinity can change without any other change
+	if (options.irq)
+	{
+		for (auto iface: get_list_of_interfaces())
+		{
+			extra += iface + '\n';
+			for (auto q: get_queue_affinity(iface))
+			{
+				extra += q.first;
+				for (auto cpu: q.second)
+					extra += " " + to_string(cpu);
+				extra += '\n';
+			}
+			for (auto i: get_irq_affinity(iface))
+			{
+				extra += to_string(i.first);
+				for (auto cpu: i.second)
+					extra += " " + to_string(cpu);
+				extra += '\n';
+			}
+		}
+	}
+
+	// The cgroup cpuset can be updated at any time
+	if (options.cpuset == "cgroup")
+	{
+		set<unsigned int> cpus;
+		if (!get_allowed_cpus(cpus))
+		{
+			extra += "allowed";
+			for (auto cpu: cpus)
+				extra += " " + to_string(cpu);
+			extra += '\n';
+		}
+	}
+
+	// Free hugepages change with every allocation
+	if (options.hugepages)
+	{
+		for (auto numa: get_numa_nodes())
+		{
+			for (auto &hp: get_numa_hugepages(numa))
+				extra += to_string(numa) + " " + to_string(hp.size_kb) + " " +
+					to_string(hp.total) + " " + to_string(hp.free) + '\n';
+		}
+	}
+
+	return extra;
+}
+
+// Check if the cache file was made with the same fingerprint,
+// print the cached output if requested
+bool cached_output(string path, string fingerprint, bool print)
+{
+	ifstream fin(path);
+	string line;
+
+	if (!fin || !getline(fin, line) || line != fingerprint)
+		return false;
+
+	if (print)
+		cout << fin.rdbuf();
+
+	return true;
+}
+
+// Write output with its fingerprint to the cache file
+void write_cached_output(string path, string fingerprint, string json_string)
+{
+	string tmp_path = path + ".tmp";
+	ofstream fout(tmp_path);
+	fout << fingerprint << '\n' << json_string;
+	fout.close();
+
+	// Replace atomically, so readers never see a partial file
+	if (!fout || rename(tmp_path.c_str(), path.c_str()))
+	{
+		cerr << "Cannot write cache file: " << path << endl;
+		remove(tmp_path.c_str());
+	}
+}
+
+// Parse "<name>@<numa>[:<speed>]"
+//
+// Returns
+// 0    success
+// else failed
+int parse_fake_sap(string spec, OPTIONS &options)
+{
+	vector<string> fields;
+	boost::split(fields, spec, boost::is_any_of("@:"));
+	if (fields.size() < 2 || fields.size() > 3 || fields[0].empty())
+		return 1;
+
+	FAKE_SAP fake;
+	try {
+		fake.name = sanitize(fields[0]);
+		fake.numa = stoul(fields[1]);
+		fake.speed = fields.size() > 2 ?
+			stoul(fields[2]) : INTERFACE_SPEED_DEFAULT;
+		fake.dpdk = false;
+	} catch (...) {
+		return 1;
+	}
+
+	options.fakesaps.push_back(fake);
+	return 0;
+}
+
+// Parse "<numa>[:<count>[:<speed>]]", DPDK SAPs are named dpdkN
+//
+// Returns
+// 0    success
+// else failed
+int parse_fake_dpdk(string spec, OPTIONS &options, unsigned int &ndpdk)
+{
+	vector<string> fields;
+	boost::split(fields, spec, boost::is_any_of(":"));
+	if (fields.size() > 3)
+		return 1;
+
+	FAKE_SAP fake;
+	unsigned int count;
+	try {
+		fake.numa = stoul(fields[0]);
+		count = fields.size() > 1 ? stoul(fields[1]) : 1;
+		fake.speed = fields.size() > 2 ?
+			stoul(fields[2]) : INTERFACE_SPEED_DEFAULT;
+		fake.dpdk = true;
+	} catch (...) {
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		fake.name = "dpdk" + to_string(ndpdk++);
+		options.fakesaps.push_back(fake);
+	}
+	return 0;
 }
 
 int main(int argc, char* argv[])
@@ -501,6 +1850,38 @@ int main(int argc, char* argv[])
 		("merge", "Merge nodes which have only one child")
 		("dpdk", "Include DPDK interfaces")
 		("notreported", "Include not reported network interfaces")
+		("irq", "Add queue and IRQ affinity (serving EEs) to network SAPs")
+		("llcgroups", "Add last level cache domains as placement groups")
+		("cpuflags", "Mark isolated/nohz_full PUs and tag SMT siblings")
+		("isolatedonly", "Exclude housekeeping (not isolated) PUs")
+		("pathmetrics", "Add SAP to EE path metrics (hops, delay, bandwidth)")
+		("nearest", po::value<unsigned int>(),
+			"Number of nearest EEs listed per SAP in path metrics "
+			"(default: 0, all)")
+		("cache", po::value<string>(),
+			"Cache file, reused while the inputs are unchanged")
+		("notmodified", "Exit with status 3 instead of printing "
+			"unchanged cached output")
+		("synthetic", po::value<string>(),
+			"Use a synthetic hwloc topology (e.g. \"node:2 core:8 pu:2\")")
+		("fakesap", po::value<vector<string>>(),
+			"Inject a network SAP: <name>@<numa>[:<speed>]")
+		("fakedpdk", po::value<vector<string>>(),
+			"Inject DPDK SAPs: <numa>[:<count>[:<speed>]]")
+		("hostroot", po::value<string>(),
+			"Query the host filesystem mounted here (e.g. /host)")
+		("cpuset", po::value<string>(),
+			"Reported PUs: host (all) or cgroup (allowed ones only)")
+		("view", po::value<vector<string>>(),
+			"Write a view to a file instead of the standard output: "
+			"<name>:<flag>[,<flag>...]:<path> (can be given several times)")
+		("stacking", "Add bonds, bridges and VLANs connected to their members")
+		("hugepages", "Add hugepage pools (page size in kB) to NUMA nodes")
+		("overlay", "Add available capacity based on utilization sampling")
+		("interval", po::value<unsigned int>(),
+			"Sampling interval of overlay in seconds (default: 1)")
+		("count", po::value<unsigned int>(),
+			"Number of overlay outputs, 0 means infinite (default: 1)")
 	;
 
 	po::variables_map vm;
@@ -529,12 +1910,163 @@ int main(int argc, char* argv[])
 		options.notreported = true;
 	}
 
+	if (vm.count("irq")) {
+		options.irq = true;
+	}
+
+	if (vm.count("llcgroups")) {
+		options.llcgroups = true;
+	}
+
+	if (vm.count("cpuflags")) {
+		options.cpuflags = true;
+	}
+
+	if (vm.count("isolatedonly")) {
+		options.isolatedonly = true;
+	}
+
+	if (vm.count("pathmetrics")) {
+		options.pathmetrics = true;
+	}
+
+	if (vm.count("nearest")) {
+		options.nearest = vm["nearest"].as<unsigned int>();
+	}
+
+	if (vm.count("overlay")) {
+		options.overlay = true;
+	}
+
+	if (vm.count("interval")) {
+		options.interval = vm["interval"].as<unsigned int>();
+	}
+
+	if (vm.count("count")) {
+		options.count = vm["count"].as<unsigned int>();
+	}
+
+	if (vm.count("cache")) {
+		options.cache = vm["cache"].as<string>();
+	}
+
+	if (vm.count("notmodified")) {
+		options.notmodified = true;
+	}
+
+	if (vm.count("synthetic")) {
+		options.synthetic = vm["synthetic"].as<string>();
+	}
+
+	if (vm.count("fakesap")) {
+		for (auto spec: vm["fakesap"].as<vector<string>>())
+			if (parse_fake_sap(spec, options)) {
+				cerr << "Invalid fake SAP: " << spec << endl;
+				return 1;
+			}
+	}
+
+	if (vm.count("fakedpdk")) {
+		unsigned int ndpdk = 0;
+		for (auto spec: vm["fakedpdk"].as<vector<string>>())
+			if (parse_fake_dpdk(spec, options, ndpdk)) {
+				cerr << "Invalid fake DPDK: " << spec << endl;
+				return 1;
+			}
+	}
+
+	if (vm.count("stacking")) {
+		options.stacking = true;
+	}
+
+	if (vm.count("hugepages")) {
+		options.hugepages = true;
+	}
+
+	if (vm.count("hostroot")) {
+		options.hostroot = vm["hostroot"].as<string>();
+		set_fsroot(options.hostroot);
+	}
+
+	if (vm.count("cpuset")) {
+		options.cpuset = vm["cpuset"].as<string>();
+		if (options.cpuset != "host" && options.cpuset != "cgroup") {
+			cerr << "Invalid cpuset: " << options.cpuset << endl;
+			return 1;
+		}
+	}
+
+	if (check_synthetic_options(options)) {
+		return 1;
+	}
+
+	if (vm.count("view")) {
+		// Views are written once to their own files
+		if (options.overlay || !options.cache.empty() || options.notmodified) {
+			cerr << "Options overlay, cache and notmodified "
+				"cannot be used with view" << endl;
+			return 1;
+		}
+
+		vector<VIEW> views;
+		for (auto spec: vm["view"].as<vector<string>>())
+		{
+			VIEW view;
+			if (parse_view(spec, options, view)) {
+				cerr << "Invalid view: " << spec << endl;
+				return 1;
+			}
+			if (check_synthetic_options(view.options)) {
+				return 1;
+			}
+			views.push_back(view);
+		}
+		return write_views(views, options);
+	}
+
+	// Overlay output changes on every sample, so it is never cached
+	string fingerprint;
+	if (!options.cache.empty() && !options.overlay)
+	{
+		fingerprint = get_input_fingerprint(
+			get_fingerprint_extra(argc, argv, options));
+
+		if (cached_output(options.cache, fingerprint, !options.notmodified))
+			return options.notmodified ? EXIT_NOT_MODIFIED : 0;
+	}
+
 	Json::Value root;
-	add_topology_tree(root, options);
+	ID id;
+	if (add_topology_tree(root, id, options))
+		return 1;
 
 	Json::StyledWriter writer;
-	string json_string = writer.write(root);
-	cout << json_string;
+
+	if (!options.overlay)
+	{
+		string json_string = writer.write(root);
+		cout << json_string;
+
+		if (!fingerprint.empty())
+			write_cached_output(options.cache, fingerprint, json_string);
+		return 0;
+	}
+
+	// Topology is discovered only once, every output re-samples utilization
+	utilization_init(get_list_of_interfaces());
+	utilization_sample();
+
+	for (unsigned int n = 0; options.count == 0 || n < options.count; n++)
+	{
+		sleep(options.interval);
+		utilization_sample();
+		add_utilization_overlay(root, id);
+
+		string json_string = writer.write(root);
+		cout << json_string << flush;
+	}
+
+	utilization_free();
 	return 0;
 }
 
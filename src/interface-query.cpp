@@ -10,11 +10,15 @@
  */
 
 #include <string.h>
+#include <set>
+#include <vector>
 #include <unordered_set>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <unistd.h>
 #include <sys/socket.h>
@@ -28,6 +32,7 @@
 #include <stdio.h>
 #include <limits.h>
 
+#include "fsroot.hpp"
 #include "interface-query.hpp"
 
 namespace fs = boost::filesystem;
@@ -38,7 +43,7 @@ int is_loopback(string dev_name)
 {
 	// A network interface is a loopback if in /sys/class/net/<iface>/flags
 	// IFF_LOOPBACK (1<<3) bit is set.
-	fs::path p("/sys/class/net/" + dev_name + "/flags");
+	fs::path p(fsroot_path("/sys/class/net/" + dev_name + "/flags"));
 	if (fs::exists(p) && fs::is_regular_file(p))
 	{
 		int flags = 0;
@@ -52,20 +57,31 @@ int is_loopback(string dev_name)
 	return 0;
 }
 
+// Interface names may contain '.', '-' and '_' (e.g. VLAN bond0.100),
+// the pattern only keeps names safe to use in paths. Whether the name
+// is an interface is decided by sysfs.
+static const boost::regex dev_regex("^[0-9a-zA-Z_-][0-9a-zA-Z._-]*$");
+
+// Interfaces are directories (links to them) in /sys/class/net,
+// e.g. bonding_masters is a file there
+static bool interface_exists(string dev_name)
+{
+	fs::path p(fsroot_path("/sys/class/net/" + dev_name));
+	return fs::exists(p) && fs::is_directory(p);
+}
+
 // Return list of interfaces except loopback
 unordered_set<string> get_list_of_interfaces()
 {
 	unordered_set<string> ifaces;
 
-	fs::path p("/sys/class/net/");
+	fs::path p(fsroot_path("/sys/class/net/"));
 	if (fs::exists(p) && fs::is_directory(p))
 	{
-		boost::regex pattern("^[a-zA-Z]+[0-9a-zA-Z]*$");
 		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(p), {}))
 		{
-			boost::smatch match;
 			std::string fn = entry.path().filename().string();
-			if (boost::regex_match( fn, match, pattern))
+			if (boost::regex_match(fn, dev_regex) && interface_exists(fn))
 			{
 				if(!is_loopback(fn))
 				{
@@ -80,17 +96,75 @@ unordered_set<string> get_list_of_interfaces()
 
 int is_network_interface(string dev_name)
 {
-	static const boost::regex dev_regex("^[a-zA-Z]+[0-9a-zA-Z]*$");
-	if(boost::regex_match(dev_name, dev_regex))
+	if(boost::regex_match(dev_name, dev_regex) && interface_exists(dev_name))
 	{
-		fs::path p("/sys/class/net/" + dev_name);
-		if(fs::exists(p))
+		return 1;
+	}
+
+	return 0;
+}
+
+// Return the interfaces a logical interface is stacked on
+// (bond slaves, bridge ports, lower device of VLANs etc.)
+vector<string> get_lower_interfaces(string dev_name)
+{
+	set<string> lowers;
+	fs::path dev(fsroot_path("/sys/class/net/" + dev_name));
+
+	// Bond slaves
+	fs::path slaves(dev / "bonding" / "slaves");
+	if (fs::exists(slaves) && fs::is_regular_file(slaves))
+	{
+		string slave;
+		fs::ifstream fin(slaves);
+		while (fin >> slave)
+			lowers.insert(slave);
+		fin.close();
+	}
+
+	// Bridge ports
+	fs::path brif(dev / "brif");
+	if (fs::exists(brif) && fs::is_directory(brif))
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(brif), {}))
+			lowers.insert(entry.path().filename().string());
+
+	// Generic lower_<iface> links (their mirrors are upper_<iface>)
+	if (fs::exists(dev) && fs::is_directory(dev))
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(dev), {}))
 		{
-			return 1;
+			string fn = entry.path().filename().string();
+			if (boost::starts_with(fn, "lower_"))
+				lowers.insert(fn.substr(6));
 		}
+
+	lowers.erase(dev_name);
+	return vector<string>(lowers.begin(), lowers.end());
+}
+
+// Return kind of a logical interface (bond, bridge, vlan, ...)
+// or empty string if not known
+string get_interface_kind(string dev_name)
+{
+	fs::path dev(fsroot_path("/sys/class/net/" + dev_name));
+
+	if (fs::exists(dev / "bonding"))
+		return "bond";
+	if (fs::exists(dev / "bridge"))
+		return "bridge";
+
+	// DEVTYPE=<kind> in uevent
+	fs::path uevent(dev / "uevent");
+	if (fs::exists(uevent) && fs::is_regular_file(uevent))
+	{
+		string line;
+		fs::ifstream fin(uevent);
+		while (getline(fin, line))
+			if (boost::starts_with(line, "DEVTYPE="))
+				return line.substr(8);
+		fin.close();
 	}
 
-	return 0;
+	return "";
 }
 
 // Get interface speed
@@ -102,7 +176,7 @@ int get_interface_speed(
 	unsigned long &res_speed, int req_speed, string dev_name)
 {
 	long long int curr_speed = -1;
-	fs::path p("/sys/class/net/" + dev_name + "/speed");
+	fs::path p(fsroot_path("/sys/class/net/" + dev_name + "/speed"));
 
 	switch(req_speed)
 	{
@@ -122,6 +196,13 @@ int get_interface_speed(
 		case REQ_SPEED_MAX:
 			int speed;
 
+			// The ioctl would query the interface of this network
+			// namespace, not the one of the host under the root
+			if (!get_fsroot().empty())
+			{
+				return 1;
+			}
+
 			if (ethernet_interface(dev_name.c_str(), &speed))
 			{
 				return 1;
@@ -12,6 +12,7 @@
  
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 const int REQ_SPEED_CONNECTED = 1;
 const int REQ_SPEED_MAX = 2;
@@ -25,3 +26,5 @@ int get_interface_speed(
 int ethernet_interface(const char *const name, int *const speed);
 int get_max_supported_speed(unsigned int smask);
 int is_network_interface(std::string dev_name);
+vector<string> get_lower_interfaces(string dev_name);
+string get_interface_kind(string dev_name);
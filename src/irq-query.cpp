@@ -0,0 +1,109 @@
+/* irq-query
+ *
+ * Query NIC queue and IRQ affinity
+ *
+ * Queues:  /sys/class/net/<iface>/queues/rx-N/rps_cpus
+ *          /sys/class/net/<iface>/queues/tx-N/xps_cpus
+ * IRQs:    /sys/class/net/<iface>/device/msi_irqs/N (or device/irq)
+ *          /proc/irq/N/smp_affinity_list
+ */
+
+#include <string>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/regex.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "fsroot.hpp"
+#include "cpu-query.hpp"
+#include "irq-query.hpp"
+
+namespace fs = boost::filesystem;
+
+using namespace std;
+
+// Order queues as rx-0, rx-1, ..., rx-10, tx-0, ...
+static bool queue_less(const pair<string, set<unsigned int>> &a,
+	const pair<string, set<unsigned int>> &b)
+{
+	string ta = a.first.substr(0, 2), tb = b.first.substr(0, 2);
+	if (ta != tb)
+		return ta < tb;
+	return stoul(a.first.substr(3)) < stoul(b.first.substr(3));
+}
+
+// Return RPS (rx) and XPS (tx) CPU sets of queues, empty masks skipped
+QueueAffinity get_queue_affinity(string dev_name)
+{
+	QueueAffinity queues;
+
+	fs::path p(fsroot_path("/sys/class/net/" + dev_name + "/queues/"));
+	if (fs::exists(p) && fs::is_directory(p))
+	{
+		static const boost::regex pattern("^(rx|tx)-[0-9]+$");
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(p), {}))
+		{
+			string fn = entry.path().filename().string();
+			if (!boost::regex_match(fn, pattern))
+				continue;
+
+			string mask_file = fn[0] == 'r' ? "rps_cpus" : "xps_cpus";
+			set<unsigned int> cpus;
+			if (read_cpu_mask(cpus, (entry.path() / mask_file).string()))
+				continue;
+
+			if (!cpus.empty())
+				queues.push_back(make_pair(fn, cpus));
+		}
+	}
+
+	sort(queues.begin(), queues.end(), queue_less);
+	return queues;
+}
+
+// Return CPU affinity of the device's IRQs (MSI/MSI-X vectors or legacy)
+IRQAffinity get_irq_affinity(string dev_name)
+{
+	IRQAffinity irqs;
+	set<unsigned int> irq_numbers;
+
+	fs::path dev(fsroot_path("/sys/class/net/" + dev_name + "/device/"));
+	fs::path msi(dev / "msi_irqs");
+	if (fs::exists(msi) && fs::is_directory(msi))
+	{
+		for(auto& entry : boost::make_iterator_range(fs::directory_iterator(msi), {}))
+		{
+			try {
+				irq_numbers.insert(stoul(entry.path().filename().string()));
+			} catch (...) {
+				continue;
+			}
+		}
+	}
+	else if (fs::exists(dev / "irq"))
+	{
+		unsigned int irq = 0;
+		fs::ifstream fin(dev / "irq");
+		fin >> irq;
+		fin.close();
+
+		// 0 means no legacy interrupt
+		if (irq)
+			irq_numbers.insert(irq);
+	}
+
+	for (auto irq: irq_numbers)
+	{
+		set<unsigned int> cpus;
+		if (read_cpu_list(cpus, fsroot_path("/proc/irq/" +
+			to_string(irq) + "/smp_affinity_list")))
+			continue;
+
+		irqs.push_back(make_pair(irq, cpus));
+	}
+
+	return irqs;
+}
@@ -0,0 +1,18 @@
+/* irq-query
+ *
+ * Query NIC queue and IRQ affinity
+ * header file
+ */
+
+#include <string>
+#include <set>
+#include <vector>
+#include <utility>
+
+typedef std::vector<std::pair<std::string, std::set<unsigned int>>>
+	QueueAffinity;
+typedef std::vector<std::pair<unsigned int, std::set<unsigned int>>>
+	IRQAffinity;
+
+QueueAffinity get_queue_affinity(std::string dev_name);
+IRQAffinity get_irq_affinity(std::string dev_name);
@@ -0,0 +1,298 @@
+/* utilization-query
+ *
+ * Periodic sampling of CPU busy time (/proc/stat) and interface
+ * counters (/sys/class/net/<iface>/statistics)
+ *
+ * Files are opened once by utilization_init() and re-read with pread()
+ * on every sample, so a sample costs one read per file and no path
+ * lookups.
+ */
+
+ /* /---->[ Uninitialised state ]
+  * |              |
+  * |      utilization_init()
+  * |              |
+  * |              v
+  * |      [ Initialised state ]<-------------\
+  * |         |      |                        |
+  * |         |  utilization_sample()         |
+  * |         |  get_cpu_busy()               |
+  * |         |  get_interface_rate()         |
+  * |         |      |                        |
+  * |         |      \------------------------/
+  * |         |
+  * |   utilization_free()
+  * |         |
+  * \---------/
+  */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fsroot.hpp"
+#include "utilization-query.hpp"
+
+using namespace std;
+
+// Counters read from /sys/class/net/<iface>/statistics
+const char *const IFACE_COUNTER_FILES[] =
+	{ "rx_bytes", "tx_bytes", "rx_packets", "tx_packets" };
+const int IFACE_COUNTERS = 4;
+
+struct CPU_TIMES
+{
+	unsigned long long busy = 0;
+	unsigned long long total = 0;
+};
+
+struct IFACE_SAMPLE
+{
+	int fd[IFACE_COUNTERS];
+	unsigned long long prev[IFACE_COUNTERS];
+	unsigned long long curr[IFACE_COUNTERS];
+	// Counters were read in the last two samples
+	bool valid;
+	bool curr_valid;
+};
+
+int stat_fd = -1;
+vector<char> stat_buf(65536);
+map<unsigned int, CPU_TIMES> cpu_prev, cpu_curr;
+map<string, IFACE_SAMPLE> iface_samples;
+double time_prev, time_curr;
+unsigned int samples = 0;
+
+static double monotonic_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read a whole file from offset 0, growing the buffer if needed
+static ssize_t pread_all(int fd, vector<char> &buf)
+{
+	ssize_t len = 0;
+
+	for (;;)
+	{
+		ssize_t n = pread(fd, buf.data() + len, buf.size() - len - 1, len);
+		if (n < 0)
+			return -1;
+		len += n;
+		if (n == 0 || (size_t)len < buf.size() - 1)
+			break;
+		buf.resize(buf.size() * 2);
+	}
+
+	buf[len] = '\0';
+	return len;
+}
+
+// Difference of two counter readings (0 if the counter was reset)
+static double delta(unsigned long long prev, unsigned long long curr)
+{
+	return curr >= prev ? (double)(curr - prev) : 0;
+}
+
+static int read_counter(int fd, unsigned long long &value)
+{
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+	if (n <= 0)
+		return 1;
+
+	buf[n] = '\0';
+	value = strtoull(buf, NULL, 10);
+	return 0;
+}
+
+// Parse "cpuN user nice system idle iowait irq softirq steal ..." lines
+static int sample_cpus()
+{
+	if (stat_fd < 0 || pread_all(stat_fd, stat_buf) < 0)
+		return 1;
+
+	cpu_curr.clear();
+
+	char *line = stat_buf.data();
+	while (line && *line)
+	{
+		char *next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		if (!strncmp(line, "cpu", 3) && line[3] >= '0' && line[3] <= '9')
+		{
+			char *p;
+			unsigned int cpu = strtoul(line + 3, &p, 10);
+			CPU_TIMES times;
+
+			for (int field = 0; *p; field++)
+			{
+				char *end;
+				unsigned long long v = strtoull(p, &end, 10);
+				if (end == p)
+					break;
+				p = end;
+
+				// guest and guest_nice are already part of user and nice
+				if (field >= 8)
+					break;
+				times.total += v;
+				// idle and iowait
+				if (field != 3 && field != 4)
+					times.busy += v;
+			}
+
+			cpu_curr[cpu] = times;
+		}
+
+		line = next;
+	}
+
+	return 0;
+}
+
+// Open /proc/stat and the statistics files of the given interfaces
+void utilization_init(unordered_set<string> ifaces)
+{
+	stat_fd = open(fsroot_path("/proc/stat").c_str(), O_RDONLY | O_CLOEXEC);
+
+	for (auto iface: ifaces)
+	{
+		IFACE_SAMPLE s;
+		bool ok = true;
+
+		for (int c = 0; c < IFACE_COUNTERS; c++)
+		{
+			string p = fsroot_path("/sys/class/net/" + iface + "/statistics/" +
+				IFACE_COUNTER_FILES[c]);
+			s.fd[c] = open(p.c_str(), O_RDONLY | O_CLOEXEC);
+			s.prev[c] = s.curr[c] = 0;
+			s.valid = s.curr_valid = false;
+			if (s.fd[c] < 0)
+				ok = false;
+		}
+
+		if (ok)
+		{
+			iface_samples.insert(make_pair(iface, s));
+		}
+		else
+		{
+			for (int c = 0; c < IFACE_COUNTERS; c++)
+				if (s.fd[c] >= 0)
+					close(s.fd[c]);
+		}
+	}
+
+	samples = 0;
+}
+
+// Close all files and drop samples
+void utilization_free()
+{
+	if (stat_fd >= 0)
+		close(stat_fd);
+	stat_fd = -1;
+
+	for (auto &i: iface_samples)
+		for (int c = 0; c < IFACE_COUNTERS; c++)
+			close(i.second.fd[c]);
+
+	iface_samples.clear();
+	cpu_prev.clear();
+	cpu_curr.clear();
+	samples = 0;
+}
+
+// Take a new sample, the previous one is kept for rate calculation
+//
+// Returns
+// 0    success
+// else failed
+int utilization_sample()
+{
+	cpu_prev.swap(cpu_curr);
+	time_prev = time_curr;
+	time_curr = monotonic_seconds();
+
+	int res = sample_cpus();
+
+	for (auto &i: iface_samples)
+	{
+		IFACE_SAMPLE &s = i.second;
+		bool ok = true;
+		for (int c = 0; c < IFACE_COUNTERS; c++)
+		{
+			s.prev[c] = s.curr[c];
+			if (read_counter(s.fd[c], s.curr[c]))
+				ok = false;
+		}
+
+		// Interface went away (reads fail on its deleted files)
+		s.valid = s.curr_valid && ok;
+		s.curr_valid = ok;
+	}
+
+	samples++;
+	return res;
+}
+
+// Busy fraction (0..1) of a CPU between the last two samples
+//
+// Returns -1 if unknown
+double get_cpu_busy(unsigned int cpu)
+{
+	if (samples < 2)
+		return -1;
+
+	auto p = cpu_prev.find(cpu);
+	auto c = cpu_curr.find(cpu);
+	if (p == cpu_prev.end() || c == cpu_curr.end())
+		return -1;
+
+	if (c->second.total <= p->second.total)
+		return 0;
+
+	double busy = delta(p->second.busy, c->second.busy);
+	double total = delta(p->second.total, c->second.total);
+	return min(1.0, max(0.0, busy / total));
+}
+
+// Traffic of an interface between the last two samples
+// (larger direction, in Mbit/s and packet/s)
+//
+// Returns
+// 0    success
+// else failed
+int get_interface_rate(string dev_name, double &mbit, double &pps)
+{
+	if (samples < 2 || time_curr <= time_prev)
+		return 1;
+
+	auto i = iface_samples.find(dev_name);
+	if (i == iface_samples.end() || !i->second.valid)
+		return 1;
+
+	IFACE_SAMPLE &s = i->second;
+	double elapsed = time_curr - time_prev;
+	double rx_bytes = delta(s.prev[0], s.curr[0]);
+	double tx_bytes = delta(s.prev[1], s.curr[1]);
+	double rx_packets = delta(s.prev[2], s.curr[2]);
+	double tx_packets = delta(s.prev[3], s.curr[3]);
+
+	mbit = max(rx_bytes, tx_bytes) * 8 / 1e6 / elapsed;
+	pps = max(rx_packets, tx_packets) / elapsed;
+	return 0;
+}
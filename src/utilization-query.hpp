@@ -0,0 +1,14 @@
+/* utilization-query
+ *
+ * Periodic sampling of CPU busy time and interface counters
+ * header file
+ */
+
+#include <string>
+#include <unordered_set>
+
+void utilization_init(std::unordered_set<std::string> ifaces);
+void utilization_free();
+int utilization_sample();
+double get_cpu_busy(unsigned int cpu);
+int get_interface_rate(std::string dev_name, double &mbit, double &pps);